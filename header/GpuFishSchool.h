@@ -0,0 +1,480 @@
+#ifndef GPU_FISH_SCHOOL_H
+#define GPU_FISH_SCHOOL_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ProgramCache.h"
+
+// GL 4.3 tokens; the loader may have been generated for 3.3 only.
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+#ifndef GL_SHADER_STORAGE_BARRIER_BIT
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+
+typedef void (APIENTRYP PFN_FISH_DISPATCHCOMPUTE)(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ);
+typedef void (APIENTRYP PFN_FISH_MEMORYBARRIER)(GLbitfield barriers);
+typedef void (APIENTRYP PFN_FISH_MULTIDRAWELEMENTSINDIRECT)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFN_FISH_UNIFORM1D)(GLint location, GLdouble x);
+
+// One fish as stored in the shader storage buffer (std430, 64 bytes).
+// Mirrors the Fish struct in main.cpp; the mesh index rides in scaleType.w.
+struct GpuFish {
+    glm::vec4 positionAngle;   // xyz = position, w = angle
+    glm::vec4 directionSpeed;  // xyz = direction, w = speed
+    glm::vec4 scaleType;       // xyz = scale, w = mesh index
+    glm::vec4 color;
+};
+
+// The constants updateSchoolFish() bounces the fish against.
+struct SchoolBounds {
+    double tanHalfFov;
+    float whRatio;
+    float aquariumDepth;
+    float epsilon;
+};
+
+// Laid out as GL expects for glMultiDrawElementsIndirect.
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Keeps the school of fish on the GPU (GL 4.3). Every frame, in the same
+// draw-then-update order as the CPU path:
+//   1. fish_cull.comp tests each fish against the view frustum and appends the
+//      visible ones to the instance range of its mesh;
+//   2. a single glMultiDrawElementsIndirect draws all meshes;
+//   3. fish_update.comp steps every fish, the same way updateSchoolFish() does,
+//      and resets the instance counts for the next frame's cull.
+// Nothing is uploaded from the CPU after upload(), apart from uniforms.
+class GpuFishSchool {
+public:
+    static constexpr int MAX_MESHES = 8;
+
+    // Needs a 4.3 context. Returns false if any entry point is missing.
+    static bool supported() {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if (major < 4 || (major == 4 && minor < 3))
+            return false;
+        Api& api = entryPoints();
+        api.dispatchCompute = (PFN_FISH_DISPATCHCOMPUTE)glfwGetProcAddress("glDispatchCompute");
+        api.memoryBarrier = (PFN_FISH_MEMORYBARRIER)glfwGetProcAddress("glMemoryBarrier");
+        api.multiDrawElementsIndirect = (PFN_FISH_MULTIDRAWELEMENTSINDIRECT)glfwGetProcAddress("glMultiDrawElementsIndirect");
+        api.uniform1d = (PFN_FISH_UNIFORM1D)glfwGetProcAddress("glUniform1d");
+        return api.dispatchCompute && api.memoryBarrier && api.multiDrawElementsIndirect && api.uniform1d;
+    }
+
+    // meshPaths[i] is the mesh drawn for fish whose mesh index is i.
+    GpuFishSchool(const std::vector<std::string>& meshPaths, const std::string& dirShader)
+        : updateProgram(std::vector<ShaderStage>{{GL_COMPUTE_SHADER, dirShader + "fish_update.comp"}}),
+          cullProgram(std::vector<ShaderStage>{{GL_COMPUTE_SHADER, dirShader + "fish_cull.comp"}}),
+          drawProgram(std::vector<ShaderStage>{{GL_VERTEX_SHADER, dirShader + "easy.vert", instancedVertexShader},
+                                               {GL_FRAGMENT_SHADER, dirShader + "easy.frag", instancedFragmentShader}}) {
+        std::vector<float> vertices;  // interleaved position, normal
+        std::vector<GLuint> indices;
+        for (const auto& path : meshPaths) {
+            if (meshes.size() == MAX_MESHES) {
+                std::cerr << "GpuFishSchool: more than " << MAX_MESHES << " meshes, ignoring " << path << std::endl;
+                meshesLoaded = false;
+                break;
+            }
+            DrawElementsIndirectCommand mesh{};
+            mesh.firstIndex = static_cast<GLuint>(indices.size());
+            mesh.baseVertex = static_cast<GLint>(vertices.size() / 6);
+            float radius = 0.0f;
+            if (!loadObj(path, vertices, indices, radius)) {
+                std::cerr << "GpuFishSchool: cannot load " << path << std::endl;
+                meshesLoaded = false;
+            }
+            mesh.count = static_cast<GLuint>(indices.size()) - mesh.firstIndex;
+            if (mesh.count == 0)
+                meshesLoaded = false;
+            meshes.push_back(mesh);
+            meshRadius.push_back(radius);
+        }
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glGenBuffers(1, &fishBuffer);
+        glGenBuffers(1, &instanceBuffer);
+        glGenBuffers(1, &commandBuffer);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+        // Visible instances written by the cull pass: position/angle, scale, color.
+        // baseInstance in each draw command offsets into this buffer.
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        for (GLuint i = 0; i < 3; ++i) {
+            glEnableVertexAttribArray(INSTANCE_ATTRIB + i);
+            glVertexAttribPointer(INSTANCE_ATTRIB + i, 4, GL_FLOAT, GL_FALSE, 3 * sizeof(glm::vec4), (void*)(i * sizeof(glm::vec4)));
+            glVertexAttribDivisor(INSTANCE_ATTRIB + i, 1);
+        }
+        glBindVertexArray(0);
+    }
+
+    ~GpuFishSchool() {
+        glDeleteVertexArrays(1, &VAO);
+        glDeleteBuffers(1, &VBO);
+        glDeleteBuffers(1, &EBO);
+        glDeleteBuffers(1, &fishBuffer);
+        glDeleteBuffers(1, &instanceBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+
+    GpuFishSchool(const GpuFishSchool&) = delete;
+    GpuFishSchool& operator=(const GpuFishSchool&) = delete;
+
+    // False if any program failed to build or any mesh failed to load, in
+    // which case the fish have to be drawn on the CPU. Waits for the programs
+    // to finish linking.
+    bool valid() {
+        return meshesLoaded && !meshes.empty() && updateProgram.linked() && cullProgram.linked() && drawProgram.linked();
+    }
+
+    // The only CPU -> GPU transfer of fish state. A fish never changes mesh,
+    // so each mesh's instance range holds exactly the fish that use it and the
+    // cull pass cannot overflow it. Fish with an unknown mesh index are never drawn.
+    void upload(const std::vector<GpuFish>& fish) {
+        fishCount = static_cast<GLuint>(fish.size());
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, fishBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, std::max<GLuint>(fishCount, 1) * sizeof(GpuFish), fish.data(), GL_DYNAMIC_COPY);
+
+        std::vector<GLuint> fishPerMesh(meshes.size(), 0);
+        for (const auto& f : fish) {
+            const int mesh = static_cast<int>(f.scaleType.w);
+            if (mesh >= 0 && mesh < static_cast<int>(meshes.size()))
+                ++fishPerMesh[mesh];
+        }
+        // Instance counts start at zero; the update pass clears them after every draw.
+        std::vector<DrawElementsIndirectCommand> commands = meshes;
+        GLuint instances = 0;
+        for (size_t i = 0; i < commands.size(); ++i) {
+            commands[i].baseInstance = instances;
+            instances += fishPerMesh[i];
+        }
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, std::max<GLuint>(instances, 1) * 3 * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_COPY);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // integrate has the same meaning as in updateSchoolFish().
+    void update(float deltaTime, const SchoolBounds& bounds, bool integrate) {
+        const Api& api = entryPoints();
+        bindStorage();
+        updateProgram.use();
+        updateProgram.set_uniform("fishCount", static_cast<int>(fishCount));
+        updateProgram.set_uniform("meshCount", static_cast<int>(meshes.size()));
+        updateProgram.set_uniform("deltaTime", deltaTime);
+        updateProgram.set_uniform("whRatio", bounds.whRatio);
+        updateProgram.set_uniform("aquariumDepth", bounds.aquariumDepth);
+        updateProgram.set_uniform("epsilon", bounds.epsilon);
+        updateProgram.set_uniform("integrate", integrate ? 1 : 0);
+        api.uniform1d(glGetUniformLocation(updateProgram.ID, "tanHalfFov"), bounds.tanHalfFov);
+        // meshCount <= MAX_MESHES < LOCAL_SIZE, so one group always resets the commands.
+        api.dispatchCompute(groupCount(), 1, 1);
+        api.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    void cull(const glm::mat4& viewProjection) {
+        const Api& api = entryPoints();
+        bindStorage();
+        cullProgram.use();
+        cullProgram.set_uniform("fishCount", static_cast<int>(fishCount));
+        cullProgram.set_uniform("meshCount", static_cast<int>(meshes.size()));
+        cullProgram.set_uniform("viewProjection", viewProjection);
+        glUniform1fv(glGetUniformLocation(cullProgram.ID, "meshRadius"), static_cast<GLsizei>(meshRadius.size()), meshRadius.data());
+        api.dispatchCompute(groupCount(), 1, 1);
+        api.memoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+
+    void draw(const glm::mat4& view, const glm::mat4& projection) {
+        drawProgram.use();
+        drawProgram.set_uniform("view", view);
+        drawProgram.set_uniform("projection", projection);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        entryPoints().multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, static_cast<GLsizei>(meshes.size()), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        glBindVertexArray(0);
+    }
+
+    void poll_reload(float now) {
+        updateProgram.poll_reload(now);
+        cullProgram.poll_reload(now);
+        drawProgram.poll_reload(now);
+    }
+
+    // Read-backs for checking the GPU path against the CPU one; they stall
+    // the pipeline and are not meant for the render loop.
+    std::vector<GpuFish> download_fish() const {
+        std::vector<GpuFish> fish(fishCount);
+        entryPoints().memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, fishBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, fish.size() * sizeof(GpuFish), fish.data());
+        return fish;
+    }
+
+    std::vector<GLuint> download_visible_counts() const {
+        std::vector<DrawElementsIndirectCommand> commands(meshes.size());
+        entryPoints().memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        std::vector<GLuint> counts;
+        for (const auto& command : commands)
+            counts.push_back(command.instanceCount);
+        return counts;
+    }
+
+    // Bounding sphere radius of each mesh around its origin, in model space.
+    const std::vector<float>& mesh_radius() const { return meshRadius; }
+
+private:
+    static constexpr GLuint LOCAL_SIZE = 64;  // local_size_x of both compute shaders
+    // First per-instance attribute, past easy.vert's own. The instanced
+    // variant is derived by rewriting two declarations, which must appear
+    // exactly once, on their own, in this form (any whitespace):
+    //   easy.vert: `uniform mat4 model;`        and a `#version` line
+    //   easy.frag: `uniform vec3 objectColor;`
+    // If either is missing or declared differently (e.g. in a uniform block
+    // or together with other uniforms), the draw program fails to build and
+    // valid() sends the fish back to the CPU path.
+    static constexpr GLuint INSTANCE_ATTRIB = 5;
+
+    // The fish are drawn with easy.vert/easy.frag, so they look exactly like
+    // the drawModel() path. The per-draw uniforms become per-instance inputs:
+    // `model` is rebuilt from the instance attributes the same way the CPU
+    // loop builds it (translate * rotate around y * scale), and `objectColor`
+    // is passed through as a flat varying.
+    static bool instancedVertexShader(std::string& source) {
+        // Leading newline: the #define must start a line wherever the uniform was.
+        const std::string declarations =
+            "\nlayout(location = " + std::to_string(INSTANCE_ATTRIB) + ") in vec4 fishPositionAngle;\n"
+            "layout(location = " + std::to_string(INSTANCE_ATTRIB + 1) + ") in vec4 fishScale;\n"
+            "layout(location = " + std::to_string(INSTANCE_ATTRIB + 2) + ") in vec4 fishColor;\n"
+            "flat out vec3 fishObjectColor;\n"
+            "mat4 fishModel() {\n"
+            "    float c = cos(fishPositionAngle.w);\n"
+            "    float s = sin(fishPositionAngle.w);\n"
+            "    return mat4(c * fishScale.x, 0.0, -s * fishScale.x, 0.0,\n"
+            "                0.0, fishScale.y, 0.0, 0.0,\n"
+            "                s * fishScale.z, 0.0, c * fishScale.z, 0.0,\n"
+            "                fishPositionAngle.xyz, 1.0);\n"
+            "}\n"
+            "#define model fishModel()\n";
+        if (!replaceUniform(source, "mat4", "model", declarations))
+            return false;
+        // Rename easy.vert's main so a wrapper can forward the color first.
+        // The #define has to follow #version, which must come first.
+        const size_t version = source.find("#version");
+        const size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+        if (lineEnd == std::string::npos) {
+            std::cerr << "GpuFishSchool: no #version line to insert after" << std::endl;
+            return false;
+        }
+        source.insert(lineEnd + 1, "#define main easyMain\n");
+        source += "\n#undef main\nvoid main() {\n    fishObjectColor = fishColor.rgb;\n    easyMain();\n}\n";
+        return true;
+    }
+
+    static bool instancedFragmentShader(std::string& source) {
+        return replaceUniform(source, "vec3", "objectColor",
+                              "\nflat in vec3 fishObjectColor;\n#define objectColor fishObjectColor\n");
+    }
+
+    // Replaces the single declaration `uniform <type> <name>;` with
+    // replacement. Fails if it is missing or declared more than once.
+    static bool replaceUniform(std::string& source, const std::string& type,
+                               const std::string& name, const std::string& replacement) {
+        const std::regex declaration("uniform\\s+" + type + "\\s+" + name + "\\s*;");
+        std::smatch match;
+        if (!std::regex_search(source, match, declaration)) {
+            std::cerr << "GpuFishSchool: no `uniform " << type << " " << name << ";` to replace" << std::endl;
+            return false;
+        }
+        const std::string rest = match.suffix().str();
+        if (std::regex_search(rest, declaration)) {
+            std::cerr << "GpuFishSchool: `uniform " << type << " " << name << ";` is declared twice" << std::endl;
+            return false;
+        }
+        source = match.prefix().str() + replacement + rest;
+        return true;
+    }
+
+    struct Api {
+        PFN_FISH_DISPATCHCOMPUTE dispatchCompute = nullptr;
+        PFN_FISH_MEMORYBARRIER memoryBarrier = nullptr;
+        PFN_FISH_MULTIDRAWELEMENTSINDIRECT multiDrawElementsIndirect = nullptr;
+        PFN_FISH_UNIFORM1D uniform1d = nullptr;
+    };
+
+    static Api& entryPoints() {
+        static Api api;
+        return api;
+    }
+
+    ShaderProgram updateProgram;
+    ShaderProgram cullProgram;
+    ShaderProgram drawProgram;
+    std::vector<DrawElementsIndirectCommand> meshes;  // count/firstIndex/baseVertex per mesh
+    std::vector<float> meshRadius;
+    bool meshesLoaded = true;
+    GLuint fishCount = 0;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLuint fishBuffer = 0, instanceBuffer = 0, commandBuffer = 0;
+
+    GLuint groupCount() const {
+        return std::max<GLuint>((fishCount + LOCAL_SIZE - 1) / LOCAL_SIZE, 1);
+    }
+
+    void bindStorage() const {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, fishBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, instanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    }
+
+    // Minimal OBJ reader (v, vn, f) producing interleaved position/normal
+    // vertices. All meshes have to share one vertex and one index buffer for
+    // the multi-draw, so Object's per-mesh buffers cannot be reused here.
+    // Corners with the same position/normal pair share a vertex. Nothing is
+    // appended unless the whole file parses and every index is in range.
+    static bool loadObj(const std::string& path, std::vector<float>& vertices, std::vector<GLuint>& indices, float& radius) {
+        std::ifstream file(path);
+        if (!file)
+            return false;
+        std::vector<glm::vec3> positions, normals;
+        std::vector<float> meshVertices;
+        std::vector<GLuint> meshIndices;
+        std::map<std::pair<int, int>, GLuint> vertexOf;  // (position, normal or -2 - face) -> vertex
+        float maxLength = 0.0f;
+        int faceCount = 0;
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream ss(line);
+            std::string tag;
+            ss >> tag;
+            if (tag == "v" || tag == "vn") {
+                glm::vec3 v(0.0f);
+                if (!(ss >> v.x >> v.y >> v.z))
+                    return false;
+                if (tag == "v") {
+                    positions.push_back(v);
+                    maxLength = std::max(maxLength, glm::length(v));
+                } else {
+                    normals.push_back(v);
+                }
+            } else if (tag == "f") {
+                std::vector<std::pair<int, int>> corners;  // position, normal (-1 if absent)
+                std::string corner;
+                while (ss >> corner) {
+                    int position = 0, normal = -1;
+                    if (!parseCorner(corner, positions.size(), normals.size(), position, normal))
+                        return false;
+                    corners.emplace_back(position, normal);
+                }
+                if (corners.size() < 3)
+                    return false;
+                const int face = faceCount++;
+                glm::vec3 a = positions[corners[0].first];
+                glm::vec3 b = positions[corners[1].first];
+                glm::vec3 c = positions[corners[2].first];
+                glm::vec3 faceNormal = glm::cross(b - a, c - a);
+                if (glm::length(faceNormal) > 0.0f)
+                    faceNormal = glm::normalize(faceNormal);
+                // Triangle fan over the polygon.
+                for (size_t i = 1; i + 1 < corners.size(); ++i) {
+                    for (size_t k : {size_t(0), i, i + 1}) {
+                        const auto [position, normal] = corners[k];
+                        // Corners without a normal use the face normal, so they are only shared within the face.
+                        const std::pair<int, int> key(position, normal >= 0 ? normal : -2 - face);
+                        auto found = vertexOf.find(key);
+                        if (found == vertexOf.end()) {
+                            glm::vec3 p = positions[position];
+                            glm::vec3 n = normal >= 0 ? normals[normal] : faceNormal;
+                            meshVertices.insert(meshVertices.end(), {p.x, p.y, p.z, n.x, n.y, n.z});
+                            found = vertexOf.emplace(key, static_cast<GLuint>(meshVertices.size() / 6 - 1)).first;
+                        }
+                        meshIndices.push_back(found->second);
+                    }
+                }
+            }
+        }
+        vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        radius = maxLength;
+        return true;
+    }
+
+    // Parses one face corner ("v", "v/vt", "v//vn" or "v/vt/vn") into 0-based
+    // position and normal indices. Negative OBJ indices count from the end.
+    static bool parseCorner(const std::string& corner, size_t positionCount, size_t normalCount, int& position, int& normal) {
+        auto parseIndex = [](const std::string& text, size_t count, int& index) {
+            int value = 0;
+            const char* end = text.data() + text.size();
+            auto [last, ec] = std::from_chars(text.data(), end, value);
+            if (ec != std::errc() || last != end || value == 0)
+                return false;
+            index = value > 0 ? value - 1 : static_cast<int>(count) + value;
+            return index >= 0 && static_cast<size_t>(index) < count;
+        };
+        const size_t first = corner.find('/');
+        if (!parseIndex(corner.substr(0, first), positionCount, position))
+            return false;
+        normal = -1;
+        if (first == std::string::npos)
+            return true;
+        const size_t second = corner.find('/', first + 1);
+        if (second == std::string::npos)
+            return true;
+        return parseIndex(corner.substr(second + 1), normalCount, normal);
+    }
+};
+
+#endif
@@ -0,0 +1,616 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Tokens from GL_ARB_get_program_binary and GL_KHR_parallel_shader_compile.
+// The context is 3.3 core, so the loader may not know about them.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+typedef void (APIENTRYP PFN_CACHE_GETPROGRAMBINARY)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_CACHE_PROGRAMBINARY)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_CACHE_PROGRAMPARAMETERI)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFN_CACHE_MAXSHADERCOMPILERTHREADS)(GLuint count);
+
+class ProgramCompiler;
+
+// What the current driver can do for us, filled once by initProgramCache().
+struct ProgramCacheCaps {
+    bool binary = false;            // glGetProgramBinary / glProgramBinary usable
+    bool parallelCompile = false;   // GL_COMPLETION_STATUS_KHR can be polled
+    std::string driver;             // vendor/renderer/version, part of every cache key
+    std::filesystem::path dir;      // where program binaries are stored
+    PFN_CACHE_GETPROGRAMBINARY getProgramBinary = nullptr;
+    PFN_CACHE_PROGRAMBINARY programBinary = nullptr;
+    PFN_CACHE_PROGRAMPARAMETERI programParameteri = nullptr;
+    GLFWwindow* compilerWindow = nullptr;  // hidden, shares objects with the render context
+    ProgramCompiler* compiler = nullptr;   // builds reloads off the render thread
+};
+
+inline ProgramCacheCaps& programCacheCaps() {
+    static ProgramCacheCaps caps;
+    return caps;
+}
+
+struct ShaderStage {
+    GLenum type;
+    std::string path;
+    // Optional in-place rewrite applied to the file before compiling, so a
+    // variant can be derived from an existing shader. The patched text is what
+    // gets hashed. Returning false fails the build like a read error would.
+    std::function<bool(std::string&)> patch{};
+    std::filesystem::file_time_type mtime{};
+};
+
+// The helpers below are shared by ShaderProgram and the compile thread; they
+// work on whichever context is current on the calling thread.
+
+inline std::filesystem::path programBinaryPath(std::uint64_t key) {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    return programCacheCaps().dir / name.str();
+}
+
+// Returns 0 when there is no usable binary; the caller then compiles.
+inline GLuint loadProgramBinary(std::uint64_t key) {
+    const ProgramCacheCaps& caps = programCacheCaps();
+    if (!caps.binary)
+        return 0;
+    std::ifstream file(programBinaryPath(key), std::ios::binary);
+    if (!file)
+        return 0;
+    GLenum format = 0;
+    if (!file.read(reinterpret_cast<char*>(&format), sizeof(format)))
+        return 0;
+    std::vector<char> blob((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (blob.empty())
+        return 0;
+
+    GLuint program = glCreateProgram();
+    caps.programBinary(program, format, blob.data(), static_cast<GLsizei>(blob.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        // Rejected by the driver, e.g. after an update that kept the same version string.
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+inline void saveProgramBinary(GLuint program, std::uint64_t key) {
+    const ProgramCacheCaps& caps = programCacheCaps();
+    if (!caps.binary)
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> blob(length);
+    GLsizei written = 0;
+    GLenum format = 0;
+    caps.getProgramBinary(program, length, &written, &format, blob.data());
+    if (written <= 0)
+        return;
+
+    // Write to a uniquely named temporary and rename it into place, so a
+    // crash or another running instance never leaves a truncated binary.
+    const std::filesystem::path target = programBinaryPath(key);
+    std::filesystem::path temp = target;
+    temp += ".tmp" + std::to_string(std::random_device{}());
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&format), sizeof(format));
+        file.write(blob.data(), written);
+        file.close();
+        if (!file) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, target, ec);
+    if (ec)
+        std::filesystem::remove(temp, ec);
+}
+
+// Drops the binary of a program that has been rebuilt from edited sources,
+// so a session of shader edits does not keep adding files to the cache.
+inline void removeProgramBinary(std::uint64_t key) {
+    if (!programCacheCaps().binary)
+        return;
+    std::error_code ec;
+    std::filesystem::remove(programBinaryPath(key), ec);
+}
+
+inline std::string describeStages(const std::vector<ShaderStage>& stages) {
+    std::string paths;
+    for (const auto& stage : stages)
+        paths += (paths.empty() ? "" : ", ") + stage.path;
+    return paths;
+}
+
+// Reads every stage and applies its patch.
+inline bool readShaderSources(const std::vector<ShaderStage>& stages, std::vector<std::string>& sources) {
+    sources.clear();
+    for (const auto& stage : stages) {
+        std::ifstream file(stage.path);
+        if (!file) {
+            std::cerr << "ProgramCache: cannot read " << stage.path << std::endl;
+            return false;
+        }
+        std::stringstream ss;
+        ss << file.rdbuf();
+        std::string source = ss.str();
+        if (stage.patch && !stage.patch(source)) {
+            std::cerr << "ProgramCache: cannot patch " << stage.path << std::endl;
+            return false;
+        }
+        sources.push_back(std::move(source));
+    }
+    return true;
+}
+
+// FNV-1a over the driver string and every stage, so a driver update or an
+// edit to any stage invalidates the stored binary.
+inline std::uint64_t programCacheKey(const std::vector<ShaderStage>& stages, const std::vector<std::string>& sources) {
+    std::uint64_t hash = 1469598103934665603ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+    const std::string& driver = programCacheCaps().driver;
+    mix(driver.data(), driver.size());
+    for (size_t i = 0; i < stages.size(); ++i) {
+        mix(&stages[i].type, sizeof(stages[i].type));
+        mix(sources[i].data(), sources[i].size());
+    }
+    return hash;
+}
+
+struct ProgramBuild {
+    GLuint program = 0;
+    std::vector<GLuint> shaders;
+    std::uint64_t key = 0;
+};
+
+// Issues compile and link without querying any status, so the driver is
+// free to do the work on its own threads.
+inline ProgramBuild beginProgramBuild(const std::vector<ShaderStage>& stages, const std::vector<std::string>& sources,
+                                      std::uint64_t key) {
+    ProgramBuild build;
+    build.key = key;
+    build.program = glCreateProgram();
+    for (size_t i = 0; i < stages.size(); ++i) {
+        GLuint shader = glCreateShader(stages[i].type);
+        const char* code = sources[i].c_str();
+        glShaderSource(shader, 1, &code, nullptr);
+        glCompileShader(shader);
+        glAttachShader(build.program, shader);
+        build.shaders.push_back(shader);
+    }
+    if (programCacheCaps().binary)
+        programCacheCaps().programParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(build.program);
+    return build;
+}
+
+inline void discardProgramBuild(ProgramBuild& build) {
+    for (GLuint shader : build.shaders) {
+        if (build.program)
+            glDetachShader(build.program, shader);
+        glDeleteShader(shader);
+    }
+    if (build.program)
+        glDeleteProgram(build.program);
+    build = ProgramBuild();
+}
+
+// Returns the linked program, or 0 after printing the logs on failure. The
+// status queries block until the driver is done. With store set, the binary
+// is written to the cache.
+inline GLuint finishProgramBuild(ProgramBuild& build, const std::vector<ShaderStage>& stages, bool store) {
+    GLint success = GL_FALSE;
+    char infoLog[1024];
+    for (size_t i = 0; i < build.shaders.size(); ++i) {
+        glGetShaderiv(build.shaders[i], GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(build.shaders[i], sizeof(infoLog), nullptr, infoLog);
+            std::cerr << "ERROR::SHADER::COMPILATION_FAILED " << stages[i].path << "\n" << infoLog << std::endl;
+        }
+    }
+    glGetProgramiv(build.program, GL_LINK_STATUS, &success);
+    GLuint program = 0;
+    if (success) {
+        if (store)
+            saveProgramBinary(build.program, build.key);
+        for (GLuint shader : build.shaders)
+            glDetachShader(build.program, shader);
+        program = build.program;
+        build.program = 0;
+    } else {
+        glGetProgramInfoLog(build.program, sizeof(infoLog), nullptr, infoLog);
+        std::cerr << "ERROR::PROGRAM::LINKING_FAILED " << describeStages(stages) << "\n" << infoLog << std::endl;
+    }
+    discardProgramBuild(build);
+    return program;
+}
+
+// Builds reloaded programs on a thread of its own, in a hidden window whose
+// context shares objects with the render context. Reading and patching the
+// sources, compiling, linking and storing the binary all happen there, so an
+// edit does not stall a frame even on drivers that compile synchronously.
+class ProgramCompiler {
+public:
+    struct Job {
+        std::vector<ShaderStage> stages;
+        std::uint64_t staleKey = 0;  // binary to remove once the rebuild succeeds
+        GLuint program = 0;          // the linked result, 0 if the build failed
+        std::uint64_t key = 0;       // cache key of program
+        bool done = false;
+        bool cancelled = false;
+    };
+
+    // The thread keeps window's context current until the compiler is destroyed.
+    explicit ProgramCompiler(GLFWwindow* window) : context(window), thread([this] { run(); }) {}
+
+    ~ProgramCompiler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    ProgramCompiler(const ProgramCompiler&) = delete;
+    ProgramCompiler& operator=(const ProgramCompiler&) = delete;
+
+    std::shared_ptr<Job> submit(const std::vector<ShaderStage>& stages, std::uint64_t staleKey) {
+        auto job = std::make_shared<Job>();
+        job->stages = stages;
+        job->staleKey = staleKey;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(job);
+        }
+        wake.notify_one();
+        return job;
+    }
+
+    // Never blocks on the build. Once it returns true, program holds the
+    // result and belongs to the caller.
+    bool finished(const std::shared_ptr<Job>& job, GLuint& program, std::uint64_t& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!job->done)
+            return false;
+        program = job->program;
+        key = job->key;
+        job->program = 0;
+        return true;
+    }
+
+    // For a job whose result is no longer wanted; the program is deleted
+    // whether or not the build has finished yet.
+    void cancel(const std::shared_ptr<Job>& job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        job->cancelled = true;
+        if (job->program) {
+            glDeleteProgram(job->program);
+            job->program = 0;
+        }
+    }
+
+private:
+    GLFWwindow* context;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<Job>> queue;
+    bool stopping = false;
+    std::thread thread;  // last, so everything it uses exists before it starts
+
+    void run() {
+        glfwMakeContextCurrent(context);
+        for (;;) {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                    break;
+                job = std::move(queue.front());
+                queue.pop_front();
+                if (job->cancelled)
+                    continue;
+            }
+            GLuint program = 0;
+            std::uint64_t key = 0;
+            std::vector<std::string> sources;
+            if (readShaderSources(job->stages, sources)) {
+                key = programCacheKey(job->stages, sources);
+                // Reverting an edit finds the earlier binary still on disk.
+                program = loadProgramBinary(key);
+                if (!program) {
+                    ProgramBuild build = beginProgramBuild(job->stages, sources, key);
+                    program = finishProgramBuild(build, job->stages, true);
+                }
+            }
+            if (program && key != job->staleKey)
+                removeProgramBinary(job->staleKey);
+            // The render context may only use the program once every command
+            // that built it has completed.
+            glFinish();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (job->cancelled) {
+                if (program)
+                    glDeleteProgram(program);
+            } else {
+                job->program = program;
+                job->key = key;
+            }
+            job->done = true;
+        }
+        glfwMakeContextCurrent(nullptr);
+    }
+};
+
+// Must be called once after the GL context is current and GLAD is loaded.
+// When window (the render window) is given, reloads are compiled in a hidden
+// window that shares its objects; shutdownProgramCache() must then be called
+// before glfwTerminate().
+inline void initProgramCache(const std::string& cacheDir, GLFWwindow* window = nullptr) {
+    ProgramCacheCaps& caps = programCacheCaps();
+    caps.dir = cacheDir;
+
+    auto glString = [](GLenum name) {
+        const GLubyte* s = glGetString(name);
+        return s ? std::string(reinterpret_cast<const char*>(s)) : std::string();
+    };
+    caps.driver = glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+
+    if (glfwExtensionSupported("GL_ARB_get_program_binary")) {
+        caps.getProgramBinary = (PFN_CACHE_GETPROGRAMBINARY)glfwGetProcAddress("glGetProgramBinary");
+        caps.programBinary = (PFN_CACHE_PROGRAMBINARY)glfwGetProcAddress("glProgramBinary");
+        caps.programParameteri = (PFN_CACHE_PROGRAMPARAMETERI)glfwGetProcAddress("glProgramParameteri");
+        GLint numFormats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+        // Some drivers expose the extension but no formats, which makes it useless.
+        caps.binary = caps.getProgramBinary && caps.programBinary && caps.programParameteri && numFormats > 0;
+    }
+
+    PFN_CACHE_MAXSHADERCOMPILERTHREADS maxThreads = nullptr;
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+        maxThreads = (PFN_CACHE_MAXSHADERCOMPILERTHREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+        maxThreads = (PFN_CACHE_MAXSHADERCOMPILERTHREADS)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+    if (maxThreads) {
+        maxThreads(0xFFFFFFFFu); // let the driver pick the thread count
+        caps.parallelCompile = true;
+    }
+
+    if (caps.binary) {
+        std::error_code ec;
+        std::filesystem::create_directories(caps.dir, ec);
+        if (ec) {
+            std::cerr << "ProgramCache: cannot create " << caps.dir << ": " << ec.message() << std::endl;
+            caps.binary = false;
+        }
+    }
+
+    if (window) {
+        // Windows can only be created on the main thread. The current hints
+        // still describe the render context, so the two contexts match.
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        caps.compilerWindow = glfwCreateWindow(1, 1, "ProgramCompiler", nullptr, window);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+        if (caps.compilerWindow)
+            caps.compiler = new ProgramCompiler(caps.compilerWindow);
+        else
+            std::cerr << "ProgramCache: cannot create a shared context for compiling reloads" << std::endl;
+    }
+    if (!caps.compiler && !caps.parallelCompile)
+        std::cerr << "ProgramCache: no compile thread or parallel shader compile, shader hot reload is off" << std::endl;
+}
+
+// Stops the compile thread. Delete every ShaderProgram first.
+inline void shutdownProgramCache() {
+    ProgramCacheCaps& caps = programCacheCaps();
+    delete caps.compiler;
+    caps.compiler = nullptr;
+    if (caps.compilerWindow) {
+        glfwDestroyWindow(caps.compilerWindow);
+        caps.compilerWindow = nullptr;
+    }
+}
+
+// A GL program built from shader files. Linked programs are stored on disk
+// with glGetProgramBinary and reloaded on later runs when neither the sources
+// nor the driver changed. The sources are also watched: poll_reload() rebuilds
+// an edited program and keeps the old one bound until the new one has linked
+// successfully. The old program's binary is then removed, so the cache holds
+// one file per program however many edits a session makes.
+//
+// Rebuilds, and storing their binaries, run on the ProgramCompiler thread;
+// the render thread only swaps the result in. Without that thread they fall
+// back to GL_KHR/ARB_parallel_shader_compile and are not stored. With neither,
+// edits are ignored rather than stalling a frame.
+class ShaderProgram {
+public:
+    GLuint ID = 0;
+
+    ShaderProgram(const char* vertexPath, const char* fragmentPath)
+        : ShaderProgram(std::vector<ShaderStage>{{GL_VERTEX_SHADER, vertexPath}, {GL_FRAGMENT_SHADER, fragmentPath}}) {}
+
+    // On a cache miss this only starts compiling, so several programs created
+    // back to back compile in parallel when the driver supports it. The link
+    // is finished the first time the program is used.
+    explicit ShaderProgram(std::vector<ShaderStage> shaderStages) : stages(std::move(shaderStages)) {
+        for (auto& stage : stages) {
+            std::error_code ec;
+            stage.mtime = std::filesystem::last_write_time(stage.path, ec);
+        }
+        std::vector<std::string> sources;
+        if (!readShaderSources(stages, sources))
+            return;
+        programKey = programCacheKey(stages, sources);
+        ID = loadProgramBinary(programKey);
+        if (ID == 0)
+            pending = beginProgramBuild(stages, sources, programKey);
+    }
+
+    ~ShaderProgram() {
+        if (reload && programCacheCaps().compiler)
+            programCacheCaps().compiler->cancel(reload);
+        discardProgramBuild(pending);
+        if (ID)
+            glDeleteProgram(ID);
+    }
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Finishes a pending build, so this may block. False if the sources could
+    // not be read or the program failed to compile or link.
+    bool linked() {
+        if (ID == 0 && pending.program)
+            ID = finishProgramBuild(pending, stages, true);
+        return ID != 0;
+    }
+
+    void use() {
+        linked();
+        glUseProgram(ID);
+    }
+
+    void set_uniform(const std::string& name, const glm::mat4& value) const {
+        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    }
+    void set_uniform(const std::string& name, const glm::vec3& value) const {
+        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, glm::value_ptr(value));
+    }
+    void set_uniform(const std::string& name, float value) const {
+        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    }
+    void set_uniform(const std::string& name, int value) const {
+        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    }
+
+    // Call once per frame. Source timestamps are checked every RELOAD_INTERVAL
+    // seconds, and a rebuild is swapped in on the first frame after it has
+    // linked. Nothing here waits for the compiler.
+    void poll_reload(float now) {
+        const ProgramCacheCaps& caps = programCacheCaps();
+        if (reload) {
+            GLuint rebuilt = 0;
+            std::uint64_t rebuiltKey = 0;
+            if (!caps.compiler || !caps.compiler->finished(reload, rebuilt, rebuiltKey))
+                return;
+            reload.reset();
+            swapIn(rebuilt, rebuiltKey);
+            return;
+        }
+        if (pending.program) {
+            if (!buildReady(pending))
+                return;
+            const std::uint64_t rebuiltKey = pending.key;
+            // Only the first build is stored; see the class comment.
+            GLuint rebuilt = finishProgramBuild(pending, stages, ID == 0);
+            if (rebuilt && rebuiltKey != programKey)
+                removeProgramBinary(programKey);
+            swapIn(rebuilt, rebuiltKey);
+            return;
+        }
+        if (!caps.compiler && !caps.parallelCompile)
+            return;
+        if (now - lastCheck < RELOAD_INTERVAL)
+            return;
+        lastCheck = now;
+
+        bool changed = false;
+        for (auto& stage : stages) {
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(stage.path, ec);
+            if (!ec && mtime != stage.mtime) {
+                stage.mtime = mtime;
+                changed = true;
+            }
+        }
+        if (!changed)
+            return;
+        if (caps.compiler) {
+            reload = caps.compiler->submit(stages, programKey);
+            return;
+        }
+        std::vector<std::string> sources;
+        if (readShaderSources(stages, sources))
+            pending = beginProgramBuild(stages, sources, programCacheKey(stages, sources));
+    }
+
+private:
+    static constexpr float RELOAD_INTERVAL = 0.5f;
+
+    std::vector<ShaderStage> stages;
+    ProgramBuild pending;                          // first build, or a reload without the compile thread
+    std::shared_ptr<ProgramCompiler::Job> reload;  // a reload on the compile thread
+    std::uint64_t programKey = 0;  // cache key of the sources ID was built from
+    float lastCheck = 0.0f;
+
+    void swapIn(GLuint rebuilt, std::uint64_t rebuiltKey) {
+        if (!rebuilt)
+            return;
+        programKey = rebuiltKey;
+        if (ID) {
+            glDeleteProgram(ID);
+            std::cout << "ProgramCache: reloaded " << describeStages(stages) << std::endl;
+        }
+        ID = rebuilt;
+    }
+
+    // Only called with parallel compile, or for the first build where
+    // finishing blocks anyway.
+    static bool buildReady(const ProgramBuild& build) {
+        if (!programCacheCaps().parallelCompile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+};
+
+#endif
@@ -3,14 +3,18 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/string_cast.hpp> // <--- 記得要加上這個！
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <numbers>
+#include <string>
 #include <vector>
 #include <cstdlib>
 #include <ctime>
 
-#include "./header/Shader.h"
 #include "./header/Object.h"
+#include "./header/ProgramCache.h"
+#include "./header/GpuFishSchool.h"
 
 // Settings
 const int INITIAL_SCR_WIDTH = 800;
@@ -30,11 +34,14 @@ int SCR_HEIGHT = INITIAL_SCR_HEIGHT;
 glm::mat4 baseModel;
 
 // Global objects
-Shader* shader = nullptr;
+ShaderProgram* shader = nullptr;
 Object* cube = nullptr;
 Object* fish1 = nullptr;
 Object* fish2 = nullptr;
 Object* fish3 = nullptr;
+GpuFishSchool* gpuSchool = nullptr;  // only set with --gpu-fish on a GL 4.3 context
+bool useGpuFish = false;
+bool swimSchoolFish = false;  // --swim-fish: move the school along their direction; both paths honour it
 
 struct Fish {
     glm::vec3 position;
@@ -89,12 +96,31 @@ void processInput(GLFWwindow* window, float deltaTime);
 void drawModel(std::string type, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& color);
 void drawPlayerFish(const glm::vec3& position, float angle, float tailPhase,
                     const glm::mat4& view, const glm::mat4& projection,  float deltaTime);
-void updateSchoolFish(float deltaTime);
+void updateSchoolFish(float deltaTime, bool integrate);
 void initializeAquarium();
 void cleanup();
 void init();
+std::vector<GpuFish> packSchoolFish();
+SchoolBounds schoolBounds();
+int verifyGpuFish(const glm::mat4& view, const glm::mat4& projection);
+
+int main(int argc, char** argv) {
+    // --gpu-fish        : simulate, cull and draw the school of fish with compute shaders (GL 4.3)
+    // --verify-gpu-fish : run the CPU and GPU fish updates side by side, compare them and exit
+    // --swim-fish       : let the school of fish swim instead of only turning at the walls
+    bool verifyGpu = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--gpu-fish") {
+            useGpuFish = true;
+        } else if (arg == "--verify-gpu-fish") {
+            useGpuFish = true;
+            verifyGpu = true;
+        } else if (arg == "--swim-fish") {
+            swimSchoolFish = true;
+        }
+    }
 
-int main() {
     // Initialize random seed for aquarium elements
     srand(static_cast<unsigned int>(time(nullptr)));
     
@@ -106,10 +132,24 @@ int main() {
 
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#else
+    if (useGpuFish) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    }
 #endif
+    if (verifyGpu)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // GLFW window creation
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GPU-Accelerated Aquarium", nullptr, nullptr);
+    if (!window && useGpuFish) {
+        std::cerr << "OpenGL 4.3 is not available, falling back to the CPU fish path" << std::endl;
+        useGpuFish = false;
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "GPU-Accelerated Aquarium", nullptr, nullptr);
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -138,6 +178,13 @@ int main() {
     //Initialze acquarium
     initializeAquarium();
 
+    if (verifyGpu) {
+        int result = verifyGpuFish(view, projection);
+        cleanup();
+        glfwTerminate();
+        return result;
+    }
+
     float lastFrame = glfwGetTime();
     //Initialze view,projection matrix
    
@@ -154,6 +201,7 @@ int main() {
         glClearColor(0.2f, 0.5f, 0.8f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        shader->poll_reload(globalTime);
         shader->use();
 
         /*=================== Example of creating model matrix ======================= 
@@ -210,18 +258,25 @@ int main() {
         // The fish movement logic is implemented.
         // All you need is to set up the position like the example in initAquarium()
         
-        for (const auto& fish : schoolFish) {
-            
-            
-
-            glm::mat4 model(1.0f);
-            model = glm::translate(model, fish.position);
-            model = glm::rotate(model, fish.angle, glm::vec3(0.0f, 1.0f, 0.0f));   //原本的魚頭是朝向+x方向，因此需要計算初始的tan角來決定魚頭的朝向
-            model = glm::scale(model, fish.scale);
-            drawModel(fish.fishType, model, view, projection, fish.color);
+        if (gpuSchool) {
+            // The fish state never leaves the GPU: cull, one indirect multi-draw, then
+            // update, in the same draw-then-update order as the CPU path below
+            gpuSchool->poll_reload(globalTime);
+            gpuSchool->cull(projection * view);
+            gpuSchool->draw(view, projection);
+            gpuSchool->update(deltaTime, schoolBounds(), swimSchoolFish);
+            shader->use();
+        } else {
+            for (const auto& fish : schoolFish) {
+                glm::mat4 model(1.0f);
+                model = glm::translate(model, fish.position);
+                model = glm::rotate(model, fish.angle, glm::vec3(0.0f, 1.0f, 0.0f));   //原本的魚頭是朝向+x方向，因此需要計算初始的tan角來決定魚頭的朝向
+                model = glm::scale(model, fish.scale);
+                drawModel(fish.fishType, model, view, projection, fish.color);
+            }
+            // Update aquarium elements
+            updateSchoolFish(deltaTime, swimSchoolFish);
         }
-        // Update aquarium elements
-        updateSchoolFish(deltaTime);
 
         // TODO: Draw Player Fish
         // You can use the provided function drawPlayerFish() or implement your own version.
@@ -357,12 +412,33 @@ void init() {
     std::string dirAsset = "asset\\";
 #endif
 
-    shader = new Shader((dirShader + "easy.vert").c_str(), (dirShader + "easy.frag").c_str());
+    // Linked programs are cached as driver binaries, so later runs skip compiling.
+    // Edited shaders are rebuilt in a context shared with this window.
+    initProgramCache(dirShader + "cache", glfwGetCurrentContext());
+    shader = new ShaderProgram((dirShader + "easy.vert").c_str(), (dirShader + "easy.frag").c_str());
    
     cube = new Object(dirAsset + "cube.obj");
-    fish1 = new Object(dirAsset + "fish1.obj");
-    fish2 = new Object(dirAsset + "fish2.obj");
-    fish3 = new Object(dirAsset + "fish3.obj");
+
+    if (useGpuFish && GpuFishSchool::supported()) {
+        // Mesh order must match fishMeshIndex()
+        gpuSchool = new GpuFishSchool({dirAsset + "fish1.obj", dirAsset + "fish2.obj", dirAsset + "fish3.obj"}, dirShader);
+        if (!gpuSchool->valid()) {
+            std::cerr << "The GPU fish school failed to build, using the CPU fish path" << std::endl;
+            delete gpuSchool;
+            gpuSchool = nullptr;
+            useGpuFish = false;
+        }
+    } else if (useGpuFish) {
+        std::cerr << "Compute shaders are not available, using the CPU fish path" << std::endl;
+        useGpuFish = false;
+    }
+
+    // The GPU school keeps its own copy of the fish meshes; only the CPU path draws these
+    if (!gpuSchool) {
+        fish1 = new Object(dirAsset + "fish1.obj");
+        fish2 = new Object(dirAsset + "fish2.obj");
+        fish3 = new Object(dirAsset + "fish3.obj");
+    }
 }
 
 void cleanup() {
@@ -375,6 +451,14 @@ void cleanup() {
         delete cube;
         cube = nullptr;
     }
+
+    if (gpuSchool) {
+        delete gpuSchool;
+        gpuSchool = nullptr;
+    }
+
+    // After every ShaderProgram is gone
+    shutdownProgramCache();
     
     for (auto& seaweed : seaweeds) {
         SeaweedSegment* current = seaweed.rootSegment;
@@ -547,10 +631,13 @@ void drawPlayerFish(const glm::vec3& position, float angle, float tailPhase,
  }
 
  
-void updateSchoolFish(float deltaTime) {
+// integrate also moves the fish along their direction (--swim-fish).
+// fish_update.comp does the same step and has to stay in sync with this.
+void updateSchoolFish(float deltaTime, bool integrate) {
     for (auto& fish : schoolFish) {
         // Move fish in their direction
-        // fish.position += fish.direction * fish.speed * deltaTime;
+        if (integrate)
+            fish.position += fish.direction * fish.speed * deltaTime;
         
         // Bounce off walls
         // The Movement is clamped within aquarium boundaries to prevent
@@ -653,6 +740,8 @@ void initializeAquarium() {
             newFish.angle = atan2(-(newFish.direction.z),newFish.direction.x);
             schoolFish.push_back(newFish);
         }
+        if (gpuSchool)
+            gpuSchool->upload(packSchoolFish());
 
 
     // You can init the aquarium elements here
@@ -673,3 +762,125 @@ void initializeAquarium() {
     //     schoolFish.push_back(fish);
     // }
 }
+
+int fishMeshIndex(const std::string& type) {
+    if (type == "fish2") return 1;
+    if (type == "fish3") return 2;
+    return 0;
+}
+
+std::vector<GpuFish> packSchoolFish() {
+    std::vector<GpuFish> packed;
+    packed.reserve(schoolFish.size());
+    for (const auto& fish : schoolFish) {
+        GpuFish gpuFish;
+        gpuFish.positionAngle = glm::vec4(fish.position, fish.angle);
+        gpuFish.directionSpeed = glm::vec4(fish.direction, fish.speed);
+        gpuFish.scaleType = glm::vec4(fish.scale, static_cast<float>(fishMeshIndex(fish.fishType)));
+        gpuFish.color = glm::vec4(fish.color, 1.0f);
+        packed.push_back(gpuFish);
+    }
+    return packed;
+}
+
+// The same constants updateSchoolFish() uses, for fish_update.comp
+SchoolBounds schoolBounds() {
+    return {std::tan(fov*0.5*PI/180.0f), WHRATIO, AQUARIUM_DEPTH, EPISILON};
+}
+
+// Steps the CPU and GPU fish updates side by side from the same state and
+// compares the results, then checks the GPU culling against the same test on
+// the CPU. Runs headless, e.g. on Mesa llvmpipe:
+//   LIBGL_ALWAYS_SOFTWARE=1 ./main --verify-gpu-fish
+int verifyGpuFish(const glm::mat4& view, const glm::mat4& projection) {
+    if (!gpuSchool) {
+        std::cerr << "verify-gpu-fish: the compute path is not available" << std::endl;
+        return 1;
+    }
+    const int steps = 600;
+    const float deltaTime = 1.0f / 60.0f;
+    const int extraFish = 4096;
+    const float positionTolerance = 1e-5f;
+    const float angleTolerance = 1e-4f;
+
+    // Scatter more fish through the tank so every wall and the frustum edges get hit
+    srand(1234u);
+    auto uniform = [](float lo, float hi) { return lo + (hi - lo) * static_cast<float>(rand()) / RAND_MAX; };
+    for (int i = 0; i < extraFish; ++i) {
+        Fish fish;
+        fish.fishType = "fish" + std::to_string(1 + i % 3);
+        fish.position = glm::vec3(uniform(-20.0f, 20.0f), uniform(-5.0f, 20.0f), uniform(-15.0f, 15.0f));
+        const float heading = uniform(0.0f, 2.0f * 3.14159f);
+        fish.direction = glm::vec3(cos(heading), uniform(-0.5f, 0.5f), sin(heading));
+        fish.angle = atan2(-fish.direction.z, fish.direction.x);
+        fish.speed = uniform(1.0f, 8.0f);
+        fish.scale = glm::vec3(uniform(0.5f, 3.0f));
+        schoolFish.push_back(fish);
+    }
+    // Both settings of --swim-fish, each from the same starting state
+    const std::vector<Fish> startFish = schoolFish;
+    size_t mismatched = 0;
+    for (bool integrate : {false, true}) {
+        schoolFish = startFish;
+        gpuSchool->upload(packSchoolFish());
+        for (int i = 0; i < steps; ++i) {
+            updateSchoolFish(deltaTime, integrate);
+            gpuSchool->update(deltaTime, schoolBounds(), integrate);
+        }
+
+        std::vector<GpuFish> gpuFish = gpuSchool->download_fish();
+        float maxPosition = 0.0f, maxDirection = 0.0f, maxAngle = 0.0f, maxTravel = 0.0f;
+        size_t modeMismatched = 0;
+        for (size_t i = 0; i < schoolFish.size(); ++i) {
+            const Fish& cpu = schoolFish[i];
+            maxTravel = std::max(maxTravel, glm::length(cpu.position - startFish[i].position));
+            float position = glm::length(cpu.position - glm::vec3(gpuFish[i].positionAngle));
+            float direction = glm::length(cpu.direction - glm::vec3(gpuFish[i].directionSpeed));
+            // atan2 may return pi or -pi for the same heading
+            float angle = std::abs(std::remainder(cpu.angle - gpuFish[i].positionAngle.w, 2.0f * static_cast<float>(PI)));
+            maxPosition = std::max(maxPosition, position);
+            maxDirection = std::max(maxDirection, direction);
+            maxAngle = std::max(maxAngle, angle);
+            if (position > positionTolerance || direction > positionTolerance || angle > angleTolerance)
+                ++modeMismatched;
+        }
+        std::cout << "verify-gpu-fish: " << schoolFish.size() << " fish, " << steps << " steps, swimming "
+                  << (integrate ? "on" : "off") << std::endl;
+        std::cout << "  max distance moved   " << maxTravel << std::endl;
+        std::cout << "  max |position| diff  " << maxPosition << std::endl;
+        std::cout << "  max |direction| diff " << maxDirection << std::endl;
+        std::cout << "  max angle diff       " << maxAngle << std::endl;
+        std::cout << "  mismatched fish      " << modeMismatched << std::endl;
+        mismatched += modeMismatched;
+    }
+
+    // Culling: the same sphere-vs-frustum test the cull shader does
+    const glm::mat4 viewProjection = projection * view;
+    gpuSchool->cull(viewProjection);
+    std::vector<GLuint> gpuVisible = gpuSchool->download_visible_counts();
+    std::vector<GLuint> cpuVisible(gpuVisible.size(), 0);
+    const glm::mat4 rows = glm::transpose(viewProjection);
+    for (const auto& fish : schoolFish) {
+        const int mesh = fishMeshIndex(fish.fishType);
+        const glm::vec3 scale = glm::abs(fish.scale);
+        const float radius = gpuSchool->mesh_radius()[mesh] * std::max(scale.x, std::max(scale.y, scale.z));
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; ++i) {
+            glm::vec4 plane = rows[3] + (i % 2 == 0 ? 1.0f : -1.0f) * rows[i / 2];
+            visible = glm::dot(glm::vec3(plane), fish.position) + plane.w >= -radius * glm::length(glm::vec3(plane));
+        }
+        if (visible)
+            ++cpuVisible[mesh];
+    }
+    // Fish lying exactly on a plane may land on either side due to rounding
+    bool cullingMatches = true;
+    for (size_t i = 0; i < gpuVisible.size(); ++i) {
+        std::cout << "  visible fish" << i + 1 << "          gpu " << gpuVisible[i] << ", cpu " << cpuVisible[i] << std::endl;
+        if (std::max(gpuVisible[i], cpuVisible[i]) - std::min(gpuVisible[i], cpuVisible[i]) > 1)
+            cullingMatches = false;
+    }
+
+    const bool passed = mismatched == 0 && cullingMatches;
+    std::cout << (passed ? "PASSED" : "FAILED") << std::endl;
+    return passed ? 0 : 1;
+}